@@ -1,22 +1,105 @@
 #include <stdio.h>
-#include <string.h>	// strlen, strcmp
+#include <stdint.h>	// uint64_t
+#include <string.h>	// strlen, strcmp, strcpy, strchr, memcpy
+#include <stdlib.h>	// atoi
+#include <time.h>	// clock, time, strftime
 
 #define RANKS 8
 #define FILES 8
 #define MAX_CHAR 8
+#define BENCH_RUNS 5
+#define BENCH_ITERS 200000
+#define MAX_PLIES 1024
+#define MAX_SAN 12
+#define RECORD_SIZE 34	// 32 bytes of 4-bit squares, side to move, result
+#define MAX_LEGAL 256
+#define MAX_LINES 5	// moves shown by the analyze command
+#define ANALYZE_DEPTH 3	// plies searched by the analyze command
+#define MAX_DEPTH 8
+#define MAX_LINE 16	// plies in a searched line, captures included
+#define MATE 10000	// search score of a mate, less the plies to it
+#define MAX_FEN 128
+#define FUZZ_PLIES 200
 
 const char *pieces = "KQRBN";
+const int worth[] = {0, 1, 3, 3, 5, 9, 0};	// . p n b r q k
+const char *startFen =
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 const int direction[][8][2] = {
 	{{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}},
 	{{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}}
 };
 
 enum player{ WHITE, BLACK };
+enum benchOp{
+	B_CHECK, B_GENERATE, B_MAKE, B_PLAY, B_STALEMATE, B_COPY, B_INPUT, B_SAN,
+	B_FEN, B_MATERIAL, B_OPS
+};
+
+const char *benchNames[] = {
+	"isCheck", "generateMoves", "copy+canMove", "copy+playMove (all moves)",
+	"isStalemate", "copyBoard", "validateInput", "writeSan (all moves)",
+	"loadFen", "isInsufficientMaterial"
+};
+const char *benchFens[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq - 0 5",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"4k3/8/8/3p4/8/8/5R2/6K1 w - - 0 1",
+};
+const char *benchPlays[] = {"Nf3", "Nc3", "Qxf6", "Rf7"};	// one per FEN
+const char *benchMoves[] = {
+	"e4", "exd5", "Nf3", "Nbd2", "R1e2", "Qxh7", "Raxd1", "O-O", "0-0-0", "e8"
+};
+volatile int benchSink;	// keeps timed results from being optimized away
+
+// hot-path counters, compiled in with -DSTATS
+#ifdef STATS
+struct {
+	long checks, copies, tested, played, rejected;
+	clock_t moveTime, resultTime;
+} stats;
+#define COUNT(c) (stats.c++)
+#define TIMER_START(t) clock_t t = clock()
+#define TIMER_STOP(t, phase) (stats.phase += clock() - (t))
+#else
+#define COUNT(c)
+#define TIMER_START(t)
+#define TIMER_STOP(t, phase)
+#endif
+
+struct move {
+	int row0, col0, row1, col1;
+	char promotion;	// 'QRBN', or 0
+};
+
+struct benchPosition {
+	char board[RANKS][FILES];
+	int turn, kings[2][2], hasCastled[2][2];
+	char enPassant[2];
+	struct move moves[MAX_LEGAL];
+	int count;
+};
+
+struct candidate {
+	char san[MAX_SAN];
+	int score;	// material at the end of the line
+	int mate;	// moves to mate, negative when mated, or 0
+	int value;	// search result the list is sorted by
+	char pv[MAX_LINE][MAX_SAN];
+	int pvLength;
+};
+
+const char *castleErrors[] = {
+	"", "Castling is no longer allowed.", "Cannot castle out of check.",
+	"King is not safe to castle.", "It is not clear to castle."
+};
 
 void printBoard(char[][FILES]);
-int printResult(int, int, char *, char, int, int);
+int printResult(int, int, char *, int, int, int);
 void setupKings(char[][FILES], int[][2]);
 void askMove(int, char *);
+char stripSuffix(char *);
 int validateInput(char *);
 int validatePawnMove(char *, int);
 int validatePieceMove(char *, int);
@@ -27,37 +110,70 @@ int isAlgebraic(char);
 int isInBounds(int, int);
 int canMove(char[][FILES], int, char *, int, char *, int[][2], int[][2], 
 	char *);
-int canCastle(char[][FILES], int, int, int[][2]);
-void trackCastle(char, int, int, int[][2]);
+int canCastle(char[][FILES], int, int, int[][2], int[][2], char *);
+int castleStatus(char[][FILES], int, int, int[][2]);
+void trackCastle(struct move *, int[][2]);
 int getRow(char);
 int getColumn(char);
 void makeMove(char *, char *);
 int isEnemy(char, int);
 int isOwn(char, int);
-char *canPieceMove(char[][MAX_CHAR], char, int, int, int, int);
+int canReach(char[][FILES], char, int, int, int, int);
 int canMoveShortRanged(char, int, int);
 int canMoveLongRanged(char[][MAX_CHAR], int, int, int, int);
-char *getMovingPawn(char[][FILES], int, char *, char *);
-char *getCapturingPawn(char[][FILES], int, char *, char *, char *);
-char promotePawn(char *, int);
-int matchPiece(char[][FILES], char, int, int);
-char *getPiece(char[][FILES], int, char *, int[][2], int);
-char *findPiece(char[][FILES], char, int, int, int[][2]);
-int isCheck(char[][FILES], int, int, int, int);
-int isCheckmate(char[][FILES], int, int, int, int, int);
+char *getMovingPawn(char[][FILES], int, char *);
+char *getCapturingPawn(char[][FILES], int, char *, char *);
+char promotePawn();
+char *getPiece(char[][FILES], int, char *, int, int[][2]);
+int isCheck(char[][FILES], int, int, int, char *);
+int isCheckmate(char[][FILES], int, int, int, char *);
 void copyBoard(char[][FILES], char[][FILES]);
 int isStalemate(char[][FILES], int, int, int, char *);
-int testPawnMove(char[][FILES], int, int, int, int, int, char *);
-int testPieceMove(char[][FILES], int, int, int, int, int);
+int generateMoves(char[][FILES], int, int[][2], char *, int[][2],
+	struct move *, int);
+int addMove(char[][FILES], int, int[][2], struct move *, int, int, int, int);
+int isLegal(char[][FILES], int, int[][2], struct move *);
+void applyMove(char[][FILES], struct move *);
+void playMove(char[][FILES], int, struct move *, int[][2], char *, int[][2]);
+int isInsufficientMaterial(char[][FILES]);
 int isKing(char);
 int isQueen(char);
 int isRook(char);
 int isBishop(char);
 int isKnight(char);
 int isPawn(char);
-
-
-int main() {
+void runBench();
+double timeOp(int, int);
+void dumpStats(int);
+void recordMove(char *, char[][FILES], struct move *, int, char[][FILES],
+	int);
+void writePgn(char *, char[][MAX_SAN], int, char *);
+int storePosition(unsigned char[][RECORD_SIZE], uint64_t *, int,
+	char[][FILES], int);
+int pieceCode(char);
+void writeRecords(char *, unsigned char[][RECORD_SIZE], int, char *);
+void analyze(char[][FILES], int, int[][2], char *, int[][2]);
+int rankMoves(char[][FILES], int, int[][2], char *, int[][2], int,
+	struct candidate *);
+int search(char[][FILES], int, int[][2], char *, int[][2], int, int, int,
+	int, struct move *, int *);
+void writeLine(char[][FILES], int, int[][2], char *, int[][2],
+	struct move *, int, struct candidate *);
+int orderMoves(char[][FILES], struct move *, int, int);
+void writeSan(char[][FILES], struct move *, int, int, char *);
+void analyzeFile(char *, int, int);
+int loadFen(const char *, char[][FILES], int *, char *, int[][2]);
+long perft(char[][FILES], int, int[][2], char *, int[][2], int);
+int runPerft(int, const char *);
+int fuzz(int, unsigned, const char *);
+int fuzzGame(int, unsigned, const char *);
+void referenceMove(char[][FILES], int, struct move *);
+void referenceRights(char[][FILES], int[][2]);
+char referencePassant(char[][FILES], char[][FILES], int);
+int material(char[][FILES], int);
+
+
+int main(int argc, char *argv[]) {
 	char board[RANKS][FILES] = {
 		{'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'},
 		{'P', 'P', 'P', 'P', 'P', 'P', 'P', 'P'},
@@ -81,35 +197,101 @@ int main() {
 	char promotion = 0;
 	int checked = 0; 
 	int stalemated = 0;
+	int drawn = 0;
+	char history[MAX_PLIES][MAX_SAN];
+	int plies = 0;
+	char *pgnFile = 0;
+	char *trainFile = 0;
+	unsigned char records[MAX_PLIES][RECORD_SIZE];
+	uint64_t hashes[MAX_PLIES];
+	int positions = 0;
+	char *score;
+	char before[RANKS][FILES];
+	struct move legal[MAX_LEGAL];
+	int n = 0;
+	char san[MAX_SAN];
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "bench")) {
+			runBench();
+			return 0;
+		} else if (!strcmp(argv[i], "perft") && i + 1 < argc) {
+			return runPerft(atoi(argv[i+1]), (i + 2 < argc) ? argv[i+2] :
+				startFen);
+		} else if (!strcmp(argv[i], "fuzz") && i + 1 < argc) {
+			return fuzz(atoi(argv[i+1]), (i + 2 < argc) ? atoi(argv[i+2]) : 1,
+				(i + 3 < argc) ? argv[i+3] : startFen);
+		} else if (!strcmp(argv[i], "analyze") && i + 1 < argc) {
+			analyzeFile(argv[i+1], (i + 2 < argc) ? atoi(argv[i+2]) : MAX_LINES,
+				(i + 3 < argc) ? atoi(argv[i+3]) : ANALYZE_DEPTH);
+			return 0;
+		} else if (!strcmp(argv[i], "pgn") && i + 1 < argc) {
+			pgnFile = argv[++i];
+		} else if (!strcmp(argv[i], "train") && i + 1 < argc) {
+			trainFile = argv[++i];
+		}
+	}
 
+	setupKings(board, kings);	// tracked incrementally from here on
 	while (isPlaying) {
 		printBoard(board);
-		setupKings(board, kings);
 		askMove(turn, input);
+		promotion = stripSuffix(input);
 
 		if (!strcmp(input, "quit")) {
 			isPlaying = 0;
+		} else if (!strcmp(input, "stats") || !strcmp(input, "json")) {
+			dumpStats(input[0] == 'j');
+			continue;
+		} else if (!strcmp(input, "analyze")) {
+			analyze(board, turn, kings, enPassant, hasCastled);
+			continue;
 		} else if ((command = validateInput(input))) {
+			// the legal moves before it, to write the move played as SAN
+			copyBoard(before, board);
+			n = generateMoves(board, turn, kings, enPassant, hasCastled, legal,
+				MAX_LEGAL);
+			TIMER_START(moveStart);
 			if (command >= 1 && command <= 4) {
 				result = canMove(board, turn, input, command, enPassant, 
 					hasCastled, kings, &promotion);
+			} else if (promotion) {
+				printf("Only a pawn reaching the last rank can promote.\n");
+				result = 0;
 			} else {
-				result = canCastle(board, turn, command-5, hasCastled);
+				result = canCastle(board, turn, command-5, hasCastled,
+					kings, enPassant);
 			}
+			TIMER_STOP(moveStart, moveTime);
 
 			if (result) {
+				COUNT(played);
+				TIMER_START(resultStart);
 				checked = isCheck(board, turn^1, kings[turn^1][0], 
-					kings[turn^1][1], 1);
+					kings[turn^1][1], enPassant);
 				if (!checked) {
 					stalemated = isStalemate(board, turn^1, kings[turn^1][0],
 						kings[turn^1][1], enPassant);
 				}
-				isPlaying = printResult(moves, turn, input, promotion,
-					checked, stalemated); 
+				if (checked != -1 && !stalemated) {
+					drawn = isInsufficientMaterial(board);
+				}
+				TIMER_STOP(resultStart, resultTime);
+				recordMove(san, before, legal, n, board, checked);
+				isPlaying = printResult(moves, turn, san, checked, stalemated,
+					drawn); 
+				if (plies < MAX_PLIES) {
+					strcpy(history[plies++], san);
+				}
+				if (trainFile && positions < MAX_PLIES) {
+					positions += storePosition(records, hashes, positions,
+						board, turn^1);
+				}
 				if (!isPlaying) {
 					printBoard(board);
 				}
 			} else {
+				COUNT(rejected);
 				printf("Illegal move.\n");
 				continue;
 			}
@@ -125,6 +307,15 @@ int main() {
 		enPassant[turn] = 0;
 	}
 
+	score = (checked == -1) ? (turn ? "1-0" : "0-1") :
+		((stalemated || drawn) ? "1/2-1/2" : "*");
+	if (pgnFile) {
+		writePgn(pgnFile, history, plies, score);
+	}
+	if (trainFile) {
+		writeRecords(trainFile, records, positions, score);
+	}
+
 	return 0;
 }
 
@@ -148,19 +339,18 @@ void printBoard(char board[][FILES]) {
 	printf("\n\n");
 }
 
-int printResult(int moves, int turn, char *input, char promotion, 
-		int checked, int stalemated) {
-	printf("%d.%s%s", moves, turn ? ".. " : " ", input);
-	if (promotion) {
-		printf("=%c", promotion);
-	}
-	printf("%s\n", (!checked) ? "" : (checked < 0 ? "#" : "+"));
+int printResult(int moves, int turn, char *san, int checked,
+		int stalemated, int drawn) {
+	printf("%d.%s%s\n", moves, turn ? ".. " : " ", san);
 	if (checked == -1) {
 		printf("\nCheckmate. %s\n", turn ? "0-1" : "1-0");
 		return 0;
 	} else if (stalemated) {
 		printf("\nStalemate. 1/2-1/2\n");
 		return 0;
+	} else if (drawn) {
+		printf("\nInsufficient material. 1/2-1/2\n");
+		return 0;
 	}
 	return 1;
 }
@@ -181,10 +371,32 @@ void setupKings(char board[][FILES], int kings[][2]) {
 
 void askMove(int turn, char *reply) {
 	printf("%s to move('quit' to quit): ", turn ? "Black" : "White");
-	scanf("%s", reply);
+	if (scanf("%7s", reply) != 1) {
+		strcpy(reply, "quit");	// end of input
+	}
 	printf("\n");
 }
 
+// drops a trailing check or mate mark and returns an "=X" promotion piece
+char stripSuffix(char *str) {
+	int len = strlen(str);
+	char c;
+
+	if (len > 2 && (str[len-1] == '+' || str[len-1] == '#')) {
+		str[--len] = 0;
+	}
+	if (len > 3 && str[len-2] == '=') {
+		c = (str[len-1] >= 'a' && str[len-1] <= 'z') ? str[len-1] - 32 :
+			str[len-1];
+		if (c == 'Q' || c == 'R' || c == 'B' || c == 'N') {
+			str[len-2] = 0;
+			return c;
+		}
+	}
+
+	return 0;
+}
+
 int validateInput(char *str) {
 	char c;
 	int len = strlen(str);
@@ -225,11 +437,13 @@ int validatePawnMove(char *str, int len) {
 
 int validatePieceMove(char *str, int len) {
 	if (len == 3 || (len == 4 && isAlgebraic(str[1])) ||
-			(len == 5 && isRank(str[1]) && isFile(str[2]))) {
+			(len == 5 && isAlgebraic(str[1]) && isAlgebraic(str[2]) &&
+			isFile(str[1]) != isFile(str[2]))) {
 		return 3;	// piece move
 	} else if ((str[1] == 'x' && len == 4) ||
 			(str[2] == 'x' && len == 5 && isAlgebraic(str[1])) ||
-			(str[3] == 'x' && len == 6 && isRank(str[1]) && isFile(str[2]))) {
+			(str[3] == 'x' && len == 6 && isAlgebraic(str[1]) &&
+			isAlgebraic(str[2]) && isFile(str[1]) != isFile(str[2]))) {
 		return 4;	// piece capture
 	}
 
@@ -267,52 +481,38 @@ int isInBounds(int m, int n) {
 int canMove(char board[][FILES], int turn, char *input, int command, 
 		char *enPassant, int hasCastled[][2], int kings[][2],
 		char *promotion) {
-	char *to, *from;
+	char *from = 0;
 	int len = strlen(input);
-	char temp = 0;
-	char *captured = 0;
-	promotion = 0;
+	struct move m;
 
 	switch(command) {
-		case 1:	from = getMovingPawn(board, turn, input, &enPassant[turn]);
+		case 1:	from = getMovingPawn(board, turn, input);
 				break;
-		case 2:	from = getCapturingPawn(board, turn, input, enPassant, 
-					captured);
+		case 2:	from = getCapturingPawn(board, turn, input, enPassant);
 				break;
 		case 3:
-		case 4:	from = getPiece(board, turn, input, hasCastled, command-3);
+		case 4:	from = getPiece(board, turn, input, command-3, kings);
 				break;
 	}
 
 	if (from) {
-		if (isKing(input[0])) {
-			kings[turn][0] = getRow(input[len-1]);
-			kings[turn][1] = getColumn(input[len-2]);
-		}
-		to = &board[getRow(input[len-1])][getColumn(input[len-2])];
-		temp = *to;
-		makeMove(to, from);
-		if (captured) {
-			*captured = '.';
-		}
-		if (command == 1 || command == 2) {
-			if ((turn == WHITE && input[len-1] == '8') ||
-					(turn == BLACK && input[len-1] == '1')) {
-				*promotion = promotePawn(to, turn);
-			}
-		}
-		if (isCheck(board, turn, kings[turn][0], kings[turn][1], 0)) {
+		m.row0 = (from - board[0]) / FILES;
+		m.col0 = (from - board[0]) % FILES;
+		m.row1 = getRow(input[len-1]);
+		m.col1 = getColumn(input[len-2]);
+		m.promotion = 0;
+		if (command <= 2 && !isLegal(board, turn, kings, &m)) {
 			printf("Move puts own king in check.\n");
-			makeMove(from, to);
-			*to = temp;
-			if (captured) {
-				*captured = turn ? 'P' : 'p';
-			}
-			if (promotion) {
-				*to = turn ? 'P' : 'p';
-			}
 			return 0;
 		}
+		if (command <= 2 && (m.row1 == 0 || m.row1 == 7)) {
+			m.promotion = *promotion ? *promotion : promotePawn();
+			*promotion = m.promotion;
+		} else if (*promotion) {
+			printf("Only a pawn reaching the last rank can promote.\n");
+			return 0;
+		}
+		playMove(board, turn, &m, kings, enPassant, hasCastled);
 
 		return 1;
 	}
@@ -321,43 +521,67 @@ int canMove(char board[][FILES], int turn, char *input, int command,
 }
 
 int canCastle(char board[][FILES], int turn, int kingside, 
+		int hasCastled[][2], int kings[][2], char *enPassant) {
+	int row = (turn == WHITE) ? 7 : 0;
+	int status = castleStatus(board, turn, kingside, hasCastled);
+	struct move m = {row, 4, row, kingside ? 6 : 2, 0};
+
+	if (status) {
+		printf("%s\n", castleErrors[status]);
+		return 0;
+	}
+	playMove(board, turn, &m, kings, enPassant, hasCastled);
+
+	return 1;
+}
+
+// returns 0 if castling is legal, otherwise an index into castleErrors
+int castleStatus(char board[][FILES], int turn, int kingside, 
 		int hasCastled[][2]) {
 	int row = (turn == WHITE) ? 7 : 0;
 	int dir = kingside ? 1 : -1;
 	int col = 4 + dir;
 
-	if (hasCastled[turn][kingside]) {
-		printf("Castling is no longer allowed.\n");
-		return 0;
+	if (hasCastled[turn][kingside] || !isKing(board[row][4]) ||
+			!isOwn(board[row][4], turn)) {
+		return 1;
+	}
+
+	if (isCheck(board, turn, row, 4, 0)) {
+		return 2;
 	}
 	
 	while (board[row][col] == '.') {
 		if (col != 1 && isCheck(board, turn, row, col, 0)) {
-			printf("King is not safe to castle.\n");
-			return 0;
+			return 3;
 		}
 		col += dir;	
 	}
 
-	if ((dir == 1 && col != 7) || (dir == -1 && col != 0)) {
-		printf("It is not clear to castle.\n");
-		return 0;
+	if ((dir == 1 && col != 7) || (dir == -1 && col != 0) ||
+			!isRook(board[row][col]) || !isOwn(board[row][col], turn)) {
+		return 4;
 	}
 
-	makeMove(&board[row][4+(dir*2)], &board[row][4]);	// king
-	makeMove(&board[row][4+dir], &board[row][(dir==1)?7:0]);
-	hasCastled[turn][0] = hasCastled[turn][1] = 1;
-
-	return 1;
+	return 0;
 }
 
-void trackCastle(char piece, int row, int col, int hasCastled[][2]) {
-	int r = row == 7 ? 0 : 1;
+// a king or rook leaving, or a rook captured on, its home square
+void trackCastle(struct move *m, int hasCastled[][2]) {
+	int squares[][2] = {{m->row0, m->col0}, {m->row1, m->col1}};
+	int r, c, side;
 
-	if ((piece == 'k' || piece == 'K') && col == 4) {
-		hasCastled[r][0] = hasCastled[r][1] = 1;
-	} else {
-		hasCastled[r][(col == 0) ? 0 : 1] = 1;
+	for (int i = 0; i < 2; i++) {
+		r = squares[i][0];
+		c = squares[i][1];
+		side = (r == 7) ? WHITE : BLACK;
+		if (r != 0 && r != 7) {
+			continue;
+		} else if (c == 4) {
+			hasCastled[side][0] = hasCastled[side][1] = 1;
+		} else if (c == 0 || c == 7) {
+			hasCastled[side][c == 7] = 1;
+		}
 	}
 }
 
@@ -394,20 +618,21 @@ int isOwn(char c, int turn) {
 		(turn == WHITE && c >= 'a' && c < 'z');
 }
 
-char *getMovingPawn(char board[][FILES], int turn, char *input, 
-		char *enPassant) {
+char *getMovingPawn(char board[][FILES], int turn, char *input) {
 	int row = getRow(input[1]);
 	int col = getColumn(input[0]);
 	int dir = (turn == WHITE) ? 1 : -1;
 	char c = (turn == WHITE) ? 'p' : 'P';
-	*enPassant = 0;
+
+	if (!isInBounds(row+dir, col)) {
+		return 0;
+	}
 
 	if (board[row][col] == '.') {
 		if (board[row+dir][col] == c) {
 			return &board[row+dir][col];
 		} else if (row == (4-turn) && board[row+dir][col] == '.' &&
 				board[turn?1:6][col] == c) {
-			*enPassant = input[0];
 			return &board[turn?1:6][col];
 		}
 	}
@@ -416,13 +641,17 @@ char *getMovingPawn(char board[][FILES], int turn, char *input,
 }
 
 char *getCapturingPawn(char board[][FILES], int turn, char *input, 
-		char *enPassant, char *captured) {
+		char *enPassant) {
 	int len = strlen(input);
 	int row = getRow(input[len-1]);
 	int col = getColumn(input[len-2]);
 	char target = board[row][col];
 	int file = getColumn(input[0]);
 
+	if (row == (turn == WHITE ? 7 : 0)) {
+		return 0;	// no pawn behind the back rank
+	}
+
 	if (file == col - 1 || file == col + 1) {
 		if (target != '.' && isEnemy(target, turn)) {	// normal capture
 			if (turn == WHITE && board[row+1][file] == 'p') {
@@ -430,14 +659,13 @@ char *getCapturingPawn(char board[][FILES], int turn, char *input,
 			} else if (turn == BLACK && board[row-1][file] == 'P') {
 				return &board[row-1][file];
 			}
-		} else if (enPassant[turn^1] == input[len-2]) {	// en passant
+		} else if (target == '.' && row == (turn == WHITE ? 2 : 5) &&
+				enPassant[turn^1] == input[len-2]) {	// en passant
 			if (turn == WHITE && isEnemy(board[row+1][col], WHITE) &&
 					board[row+1][file] == 'p') {
-				captured = &board[row+1][col];
 				return &board[row+1][file];
 			} else if (turn == BLACK && isEnemy(board[row-1][col], BLACK) &&
 					board[row-1][file] == 'P') {
-				captured = &board[row-1][col];
 				return &board[row-1][file];
 			}
 		}
@@ -446,7 +674,7 @@ char *getCapturingPawn(char board[][FILES], int turn, char *input,
 	return 0;
 }
 
-char promotePawn(char *to, int turn) {
+char promotePawn() {
 	char c;
 
 	do {
@@ -458,31 +686,11 @@ char promotePawn(char *to, int turn) {
 		}
 	} while (c != 'Q' && c != 'R' && c != 'B' && c != 'N');
 
-	*to = (turn == WHITE) ? (c + 32) : c;
-
 	return c;
 }
 
-int matchPiece(char board[][FILES], char piece, int row, int col) {
-	int found = 0;
-	int dim = (row == -1) ? 0 : 1;
-	int missing = -1;
-
-	for (int i = 0; i < 8; i++) {
-		if (piece == (dim ? board[row][i] : board[i][col])) {
-			if (!found++) {
-				missing = i;
-			} else {
-				return -1;
-			}
-		}
-	}
-
-	return missing;
-}
-
-char *getPiece(char board[][FILES], int turn, char *input, 
-		int hasCastled[][2], int isCapturing) {
+char *getPiece(char board[][FILES], int turn, char *input, int isCapturing,
+		int kings[][2]) {
 	int len = strlen(input);
 	int row0 = -1;
 	int col0 = -1;
@@ -490,52 +698,62 @@ char *getPiece(char board[][FILES], int turn, char *input,
 	int col1 = getColumn(input[len-2]);
 	char piece = (turn == WHITE) ? (input[0] + 32) : input[0];
 	char *square = 0;
+	int reached = 0, found = 0;
+	struct move m = {0, 0, row1, col1, 0};
 
-	if ((!isCapturing && board[row1][col1] == '.') ||
-			(isCapturing && isEnemy(board[row1][col1], turn))) {
-		if ((len == 5 && !isCapturing) || (len == 6 && isCapturing)) {
-			row0 = getRow(input[1]);
-			col0 = getColumn(input[2]);
-			if (board[row0][col0] != piece) {
-				printf("Piece is not located in that square.\n");
-				return 0;
-			}
-			square = canPieceMove(board, piece, row0, col0, row1, col1);
-		} else if ((len == 4 && !isCapturing) || (len == 5 && isCapturing)) {
-			if	(isFile(input[1])) {
-				col0 = getColumn(input[1]);
-				row0 = matchPiece(board, piece, -1, col0);
-			} else {
-				row0 = getRow(input[1]);
-				col0 = matchPiece(board, piece, row0, -1);
+	if ((!isCapturing && board[row1][col1] != '.') ||
+			(isCapturing && !isEnemy(board[row1][col1], turn))) {
+		return 0;
+	}
+
+	// optional file and/or rank of the moving piece
+	for (int i = 1; i < len - 2; i++) {
+		if (isFile(input[i])) {
+			col0 = getColumn(input[i]);
+		} else if (isRank(input[i])) {
+			row0 = getRow(input[i]);
+		}
+	}
+
+	for (m.row0 = 0; m.row0 < RANKS; m.row0++) {
+		for (m.col0 = 0; m.col0 < FILES; m.col0++) {
+			if (board[m.row0][m.col0] != piece ||
+					(row0 != -1 && m.row0 != row0) ||
+					(col0 != -1 && m.col0 != col0) ||
+					!canReach(board, piece, m.row0, m.col0, row1, col1)) {
+				continue;
 			}
-			if (row0 == -1 || col0 == -1) {
-				printf("There is no piece matching rank or file given.\n");
-				return 0;
+			reached++;
+			if (isLegal(board, turn, kings, &m)) {
+				if (found++) {
+					printf("Another piece found that can make same move.\n");
+					return 0;
+				}
+				square = &board[m.row0][m.col0];
 			}
-			square = canPieceMove(board, piece, row0, col0, row1, col1);
-		} else {
-			return findPiece(board, piece, row1, col1, hasCastled);
 		}
 	}
-	if (square) {
-		trackCastle(piece, row0, col0, hasCastled);
+
+	if (!reached) {
+		printf("The piece cannot move to this square.\n");
+	} else if (!found) {
+		printf("Move puts own king in check.\n");
 	}
 
 	return square;
 }
 
-char *canPieceMove(char board[][FILES], char piece, int row0, int col0, 
-		int row1, int col1) {
-	if ((isKnight(piece) || isKing(piece)) &&
-		(canMoveShortRanged(piece, row1-row0, col1-col0))) {
-			return &board[row0][col0];
-	} else if (canMoveLongRanged(board, row0, col0, row1, col1)) {
-		return &board[row0][col0];
+int canReach(char board[][FILES], char piece, int row0, int col0, int row1,
+		int col1) {
+	int straight = (row0 == row1 || col0 == col1);
+
+	if (isKnight(piece) || isKing(piece)) {
+		return canMoveShortRanged(piece, row1-row0, col1-col0);
 	}
-	printf("The piece cannot move to this square.\n");
 
-	return 0;
+	return (isQueen(piece) || (isRook(piece) && straight) ||
+			(isBishop(piece) && !straight)) &&
+			canMoveLongRanged(board, row0, col0, row1, col1);
 }
 
 int canMoveShortRanged(char piece, int rows, int cols) {
@@ -557,7 +775,13 @@ int canMoveLongRanged(char board[][FILES], int row0, int col0, int row1,
 	r = (row1 - row0) ? ((row1 < row0) ? -1 : 1) : 0; 
 	c = (col1 - col0) ? ((col1 < col0) ? -1 : 1) : 0; 
 
-	for (i = row0 + r, j = col0 + c; i != row1 && j != col1; i += r, j += c) {
+	// must be a straight or diagonal line
+	if (row0 != row1 && col0 != col1 &&
+			(row1 - row0) * c != (col1 - col0) * r) {
+		return 0;
+	}
+
+	for (i = row0 + r, j = col0 + c; i != row1 || j != col1; i += r, j += c) {
 		if (board[i][j] != '.') {
 			return 0;
 		}
@@ -566,51 +790,15 @@ int canMoveLongRanged(char board[][FILES], int row0, int col0, int row1,
 	return 1;
 }
 
-char *findPiece (char board[][FILES], char piece, int row1, int col1,
-		int hasCastled[][2]) {
-	int row0, col0, r, c;
-	int found = 0;
-	char *square = 0;
-	int i = isKnight(piece) ? 1 : 0;
-	int j = isBishop(piece) ? 1 : 0;
-	int inc = (isBishop(piece) || isRook(piece)) ? 2 : 1;
-
-	for (; j < 8; j += inc) {
-		r = row1 + direction[i][j][0];
-		c = col1 + direction[i][j][1];
-
-		while (isInBounds(r, c) &&
-				(board[r][c] == piece || board[r][c] == '.')) {
-			if (board[r][c] == piece) {
-				if (!found++) {
-					square = &board[(row0=r)][(col0=c)];
-				} else {
-					printf("Another piece found that can make same move.\n");
-					return 0;
-				}
-			}
-			if (isKnight(piece) || isKing(piece)) {
-				break;
-			}
-			r += direction[i][j][0];
-			c += direction[i][j][1];
-		}
-	}
-
-	if (square && (isRook(piece) || isKing(piece))) {
-		trackCastle(piece, row0, col0, hasCastled);
-	}
-
-	return square;
-}
-
-int isCheck(char board[][FILES], int turn, int row, int col, int mateCheck) {
+// mateCheck: en passant flags to also test for mate with, or 0
+int isCheck(char board[][FILES], int turn, int row, int col, char *mateCheck) {
 	int r, c, atkRow, atkCol;
 	int checked = 0;
-	char tester[RANKS][FILES];
 	char pawn;
 	char *square;
 
+	COUNT(checks);
+
 	// pawns
 	if ((turn == WHITE && row - 1 > 0) || (turn == BLACK && row + 1 < 7)) {
 		atkRow = row + (turn == WHITE ? -1 : 1);
@@ -620,7 +808,7 @@ int isCheck(char board[][FILES], int turn, int row, int col, int mateCheck) {
 				(col + 1 <= 7 && board[(atkRow)][(atkCol=col+1)] == pawn)) {
 			if (!mateCheck) {
 				return (atkRow * RANKS) + atkCol + 1;
-			} else if (isCheckmate(board, turn, row, col, atkRow, atkCol)) {
+			} else if (isCheckmate(board, turn, row, col, mateCheck)) {
 				return -1;
 			}
 			checked++;
@@ -655,27 +843,17 @@ int isCheck(char board[][FILES], int turn, int row, int col, int mateCheck) {
 							((turn == WHITE && *square == 'N') ||
 							(turn == BLACK && *square == 'n')))) {
 						if (!mateCheck) {
-							if ((*square == 'K' && turn == WHITE) ||
-									(*square == 'k' && turn == BLACK)) {
-								copyBoard(tester, board);
-								makeMove(&tester[row][col], &tester[r][c]);
-								if (isCheck(tester, turn^1, row, col, 0)) {
-									continue;
-								}
-							}
 							return (r * RANKS) + c + 1;
-						} else if (isCheckmate(board, turn, row, col, r, c)) {
+						} else if (isCheckmate(board, turn, row, col, mateCheck)) {
 							return -1;
 						}
 						checked++;
-					} else {
-						break;
 					}
-				}
-				if (*square == 'K' || *square == 'k'|| 
-						*square == 'N' || *square == 'n') {
 					break;
 				}
+				if (i == 1) {
+					break;	// knights do not slide
+				}
 				r += direction[i][j][0];
 				c += direction[i][j][1];
 			}
@@ -685,57 +863,13 @@ int isCheck(char board[][FILES], int turn, int row, int col, int mateCheck) {
 }
 
 int isCheckmate(char board[][FILES], int turn, int kRow, int kCol, 
-		int atkRow, int atkCol) {
-	int i, j, r, c, square, difRow, difCol;
-	char tester[RANKS][FILES];
-
-	// check for square that king can escape to
-	for (i = 0; i < 8; i++) {
-		if ((board[r][c] == '.' || isEnemy(board[r][c], turn)) &&
-				!isCheck(board, turn, direction[0][i][0]+kRow, 
-				direction[0][i][1]+kCol, 0)) {
-			return 0;	// can escape
-		}
-	}
-
-	// check if attacking piece can be captured
-	copyBoard(tester, board);
-
-	if ((square = isCheck(board, turn^1, atkRow, atkCol, 0))) {
-		makeMove(&tester[atkRow][atkCol], 
-			&tester[(square-1)/8][(square-1)%8]);
-		// attacking piece can be captured
-		if (!isCheck(tester, turn, kRow, kCol, 0)) {
-			return 0;
-		}
-	}
-
-	// check if attacking piece (bishops, rooks, queen) can be blocked instead
-	if (isBishop(board[atkRow][atkCol]) || isRook(board[atkRow][atkCol]) ||
-			isQueen(board[atkRow][atkCol])) {
-		copyBoard(tester, board);
-
-		//check path between attacker and king
-		i = ((difRow=atkRow-kRow) ? (difRow < 0 ? -1 : 1) : 0);
-		j = ((difCol=atkCol-kCol) ? (difCol < 0 ? -1 : 1) : 0);
-		r = kRow + i;
-		c = kCol + j; 
-		while (!(r == atkRow && c == atkCol)) {
-			square = isCheck(tester, turn, r, c, 0);
-			makeMove(&tester[atkRow][atkCol], 
-					&tester[(square-1)/8][(square-1)%8]);
-				if (!isCheck(tester, turn, kRow, kCol, 0)) {
-					return 0;
-				}
-			r += i;
-			c += j;
-		}
-	}
-
-	return 1;
+		char *enPassant) {
+	// in check, so any legal move is an escape, capture or block
+	return isStalemate(board, turn, kRow, kCol, enPassant);
 }
 
 void copyBoard(char to[][FILES], char from[][FILES]) {
+	COUNT(copies);
 	for (int i = 0; i < RANKS; i++) {
 		for (int j = 0; j < FILES; j++) {
 			to[i][j] = from[i][j];
@@ -745,86 +879,177 @@ void copyBoard(char to[][FILES], char from[][FILES]) {
 
 int isStalemate(char board[][FILES], int turn, int kRow, int kCol, 
 		char *enPassant) {
+	struct move list[MAX_LEGAL];
+	int kings[2][2];
+	int noCastling[][2] = {{1, 1}, {1, 1}};	// never the only legal move
+
+	kings[turn][0] = kRow;
+	kings[turn][1] = kCol;
+
+	return !generateMoves(board, turn, kings, enPassant, noCastling, list, 1);
+}
+
+// fills list with legal moves for turn, stopping once limit are found
+int generateMoves(char board[][FILES], int turn, int kings[][2],
+		char *enPassant, int hasCastled[][2], struct move *list, int limit) {
+	int n = 0;
+	int dir = turn ? 1 : -1;
+	int i, j, inc, r, c;
 	char piece;
 
-	for (int i = 0; i < RANKS; i++) {
-		for (int j = 0; j < FILES; j++) {
-			if (isOwn(board[i][j], turn)) {
-				piece = board[i][j];
-				if ((isPawn(piece) &&
-						testPawnMove(board, turn, i, j, kRow, kCol, 
-						enPassant)) ||
-						(!isPawn(piece) &&
-						testPieceMove(board, turn, i, j, kRow, kCol))) {
-					return 0;
+	for (int row = 0; row < RANKS && n < limit; row++) {
+		for (int col = 0; col < FILES && n < limit; col++) {
+			piece = board[row][col];
+			if (!isOwn(piece, turn)) {
+				continue;
+			}
+			if (isPawn(piece)) {
+				r = row + dir;
+				if (!isInBounds(r, col)) {
+					continue;
+				}
+				if (board[r][col] == '.') {
+					n += addMove(board, turn, kings, &list[n], row, col, r, col);
+					if (row == (turn ? 1 : 6) && board[r+dir][col] == '.') {
+						n += addMove(board, turn, kings, &list[n], row, col,
+							r+dir, col);
+					}
+				}
+				for (c = col - 1; c <= col + 1; c += 2) {
+					if (isInBounds(r, c) && (isEnemy(board[r][c], turn) ||
+							(board[r][c] == '.' && row == (turn ? 4 : 3) &&
+							board[row][c] == (turn ? 'p' : 'P') &&
+							enPassant[turn^1] == getFile(c)))) {
+						n += addMove(board, turn, kings, &list[n], row, col,
+							r, c);
+					}
+				}
+				continue;
+			}
+
+			i = (isKnight(piece)) ? 1 : 0;
+			j = (isBishop(piece)) ? 1 : 0;
+			inc = (isBishop(piece) || isRook(piece)) ? 2 : 1;
+			for (; j < 8 && n < limit; j += inc) {
+				r = row + direction[i][j][0];
+				c = col + direction[i][j][1];
+				while (isInBounds(r, c) && !isOwn(board[r][c], turn)) {
+					n += addMove(board, turn, kings, &list[n], row, col, r, c);
+					if (board[r][c] != '.' || isKnight(piece) ||
+							isKing(piece)) {
+						break;
+					}
+					r += direction[i][j][0];
+					c += direction[i][j][1];
 				}
 			}
 		}
 	}
 
-	return 1;
+	r = (turn == WHITE) ? 7 : 0;
+	for (int side = 0; side < 2 && n < limit; side++) {
+		if (!castleStatus(board, turn, side, hasCastled)) {
+			struct move m = {r, 4, r, side ? 6 : 2, 0};
+			list[n++] = m;
+		}
+	}
+
+	return n;
 }
 
-int testPawnMove(char board[][FILES], int turn, int row, int col, int kRow,
-		int kCol, char *enPassant) {
-	char r, c;
-	char piece = board[row][col];
-	char tester[RANKS][FILES];
-	int dir = turn ? 1 : -1;
-	char enemyPawn = turn ? 'p' : 'P';
+// adds the move if legal, once per promotion piece; returns moves added
+int addMove(char board[][FILES], int turn, int kings[][2], struct move *list,
+		int row0, int col0, int row1, int col1) {
+	const char *promotions = "QRBN";
+	struct move m = {row0, col0, row1, col1, 0};
+	int n = 0;
 
-	if (isInBounds(row+dir, col) && board[row+dir][col] == '.') {
-		r = row + dir;
-		copyBoard(tester, board);
-		makeMove(&tester[r][col], &tester[r][col]);
-		if (!isCheck(tester, turn, kRow, kCol, 0)) {
-			return 1;
-		}
+	if (!isLegal(board, turn, kings, &m)) {
+		return 0;
 	}
-
-	for (int i = -1; i < 2; i += 2) {
-		r = row + dir;
-		c = col + i;
-		if (isInBounds(r, c) && (isEnemy(board[r][c], turn) ||
-				(board[r][c] == '.' && board[row][c] == enemyPawn &&
-				enPassant[turn^1] == getRank(c)))) {
-			copyBoard(tester, board);
-			makeMove(&tester[r][col], &tester[r][col]);
-			if (!isCheck(tester, turn, kRow, kCol, 0)) {
-				return 1;
-			}
-		}
+	if (!isPawn(board[row0][col0]) || (row1 != 0 && row1 != 7)) {
+		list[0] = m;
+		return 1;
+	}
+	for (; promotions[n]; n++) {
+		list[n] = m;
+		list[n].promotion = promotions[n];
 	}
 
-	return 0;
+	return n;
 }
 
-int testPieceMove(char board[][FILES], int turn, int row, int col, int kRow,
-		int kCol) {
-	int i, j, inc, r, c;
-	char piece = board[row][col];
+int isLegal(char board[][FILES], int turn, int kings[][2], struct move *m) {
 	char tester[RANKS][FILES];
+	int king = isKing(board[m->row0][m->col0]);
 
-	i = (isKnight(piece)) ? 1 : 0;
-	j = (isBishop(piece)) ? 1 : 0;
-	inc = (isBishop(piece) || isRook(piece)) ? 2 : 1;
-
-	for (; j < 8; j += inc) {
-		r = row + direction[i][j][0];
-		c = col + direction[i][j][1];
-		if (isInBounds(r, c) && board[r][c] == '.') {
-			copyBoard(tester, board);
-			makeMove(&tester[r][c], &tester[row][col]);
-			if (isKing(piece)) {
-				kRow = r;
-				kCol = c;
-			}
-			if (!isCheck(tester, turn, kRow, kCol, 0)) {
-				return 1;
+	COUNT(tested);
+	copyBoard(tester, board);
+	applyMove(tester, m);
+
+	return !isCheck(tester, turn, king ? m->row1 : kings[turn][0],
+		king ? m->col1 : kings[turn][1], 0);
+}
+
+// moves the pieces only: en passant victims, castling rooks, promotions
+void applyMove(char board[][FILES], struct move *m) {
+	char piece = board[m->row0][m->col0];
+	int dir = (m->col1 > m->col0) ? 1 : -1;
+
+	if (isPawn(piece) && m->col0 != m->col1 &&
+			board[m->row1][m->col1] == '.') {
+		board[m->row0][m->col1] = '.';	// en passant
+	}
+	if (isKing(piece) && (m->col1 - m->col0) * dir == 2) {
+		makeMove(&board[m->row0][m->col0+dir],
+			&board[m->row0][(dir == 1) ? 7 : 0]);	// castling rook
+	}
+	makeMove(&board[m->row1][m->col1], &board[m->row0][m->col0]);
+	if (m->promotion) {
+		board[m->row1][m->col1] = (piece == 'p') ? m->promotion + 32 :
+			m->promotion;
+	}
+}
+
+// applies the move and updates the king squares, en passant and castling
+void playMove(char board[][FILES], int turn, struct move *m, int kings[][2],
+		char *enPassant, int hasCastled[][2]) {
+	char piece = board[m->row0][m->col0];
+
+	trackCastle(m, hasCastled);
+	enPassant[turn] = (isPawn(piece) &&
+		(m->row1 - m->row0) * (m->row1 - m->row0) == 4) ? getFile(m->col0) : 0;
+	applyMove(board, m);
+	if (isKing(piece)) {
+		kings[turn][0] = m->row1;
+		kings[turn][1] = m->col1;
+	}
+}
+
+int isInsufficientMaterial(char board[][FILES]) {
+	int minors = 0;
+	int bishops[] = {0, 0};	// bishops on light, dark squares
+
+	for (int i = 0; i < RANKS; i++) {
+		for (int j = 0; j < FILES; j++) {
+			if (board[i][j] == '.' || isKing(board[i][j])) {
+				continue;
+			} else if (isBishop(board[i][j])) {
+				bishops[(i + j) % 2]++;
+			} else if (isKnight(board[i][j])) {
+				minors++;
+			} else {
+				return 0;	// pawn, rook or queen can still mate
 			}
 		}
 	}
 
+	// lone minor piece, or any number of bishops all on one colour
+	if (minors + bishops[0] + bishops[1] <= 1 ||
+			(!minors && (!bishops[0] || !bishops[1]))) {
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -851,3 +1076,839 @@ int isKnight(char c) {
 int isPawn(char c) {
 	return c == 'p' || c == 'P';
 }
+
+void runBench() {
+	double t, best;
+	int n;
+
+	printf("%-24s %12s %14s\n", "operation", "ns/op", "ops/sec");
+	for (int op = 0; op < B_OPS; op++) {
+		n = (op == B_INPUT) ? sizeof(benchMoves) / sizeof(benchMoves[0]) :
+			sizeof(benchFens) / sizeof(benchFens[0]);
+		timeOp(op, BENCH_ITERS);	// warmup
+		best = -1;
+		for (int i = 0; i < BENCH_RUNS; i++) {
+			t = timeOp(op, BENCH_ITERS);
+			if (best < 0 || t < best) {
+				best = t;
+			}
+		}
+		best /= (double) BENCH_ITERS * n;
+		printf("%-24s %12.1f %14.0f\n", benchNames[op], best * 1e9,
+			best > 0 ? 1 / best : 0);
+	}
+}
+
+// per position except validateInput, which is per string
+double timeOp(int op, int iters) {
+	int n = sizeof(benchFens) / sizeof(benchFens[0]);
+	int m = sizeof(benchMoves) / sizeof(benchMoves[0]);
+	static struct benchPosition pos[sizeof(benchFens) / sizeof(benchFens[0])];
+	struct benchPosition *p;
+	char tester[RANKS][FILES];
+	int kings[2][2], hasCastled[2][2], commands[n];
+	char enPassant[2], promotion, san[MAX_SAN];
+	char input[MAX_CHAR];
+	clock_t start;
+
+	for (int i = 0; i < n; i++) {
+		p = &pos[i];
+		loadFen(benchFens[i], p->board, &p->turn, p->enPassant,
+			p->hasCastled);
+		setupKings(p->board, p->kings);
+		p->count = generateMoves(p->board, p->turn, p->kings, p->enPassant,
+			p->hasCastled, p->moves, MAX_LEGAL);
+		strcpy(input, benchPlays[i]);
+		commands[i] = validateInput(input);
+	}
+
+	start = clock();
+	for (int k = 0; k < iters; k++) {
+		if (op == B_INPUT) {
+			for (int i = 0; i < m; i++) {
+				strcpy(input, benchMoves[i]);
+				benchSink += validateInput(input);
+			}
+			continue;
+		}
+		for (int i = 0; i < n; i++) {
+			p = &pos[i];
+			switch (op) {
+				case B_CHECK:	benchSink += isCheck(p->board, p->turn,
+									p->kings[p->turn][0], p->kings[p->turn][1],
+									0);
+								break;
+				case B_GENERATE:	benchSink += generateMoves(p->board, p->turn,
+									p->kings, p->enPassant, p->hasCastled,
+									p->moves, MAX_LEGAL);
+								break;
+				case B_MAKE:	copyBoard(tester, p->board);
+								memcpy(kings, p->kings, sizeof(kings));
+								memcpy(hasCastled, p->hasCastled,
+									sizeof(hasCastled));
+								memcpy(enPassant, p->enPassant,
+									sizeof(enPassant));
+								promotion = 0;
+								strcpy(input, benchPlays[i]);
+								benchSink += canMove(tester, p->turn, input,
+									commands[i], enPassant, hasCastled, kings,
+									&promotion);
+								break;
+				case B_PLAY:	for (int j = 0; j < p->count; j++) {
+									copyBoard(tester, p->board);
+									memcpy(kings, p->kings, sizeof(kings));
+									memcpy(hasCastled, p->hasCastled,
+										sizeof(hasCastled));
+									memcpy(enPassant, p->enPassant,
+										sizeof(enPassant));
+									playMove(tester, p->turn, &p->moves[j],
+										kings, enPassant, hasCastled);
+									benchSink += tester[p->moves[j].row1][0];
+								}
+								break;
+				case B_STALEMATE:	benchSink += isStalemate(p->board, p->turn,
+									p->kings[p->turn][0], p->kings[p->turn][1],
+									p->enPassant);
+								break;
+				case B_COPY:	copyBoard(tester, p->board);
+								benchSink += tester[k % RANKS][i];
+								break;
+				case B_SAN:		for (int j = 0; j < p->count; j++) {
+									writeSan(p->board, p->moves, p->count, j,
+										san);
+									benchSink += san[1];
+								}
+								break;
+				case B_FEN:		benchSink += loadFen(benchFens[i],
+									tester, &kings[0][0], enPassant,
+									hasCastled);
+								break;
+				case B_MATERIAL:	benchSink += isInsufficientMaterial(p->board);
+								break;
+			}
+		}
+	}
+
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+void dumpStats(int json) {
+#ifdef STATS
+	double moveMs = stats.moveTime * 1000.0 / CLOCKS_PER_SEC;
+	double resultMs = stats.resultTime * 1000.0 / CLOCKS_PER_SEC;
+
+	if (json) {
+		printf("{\"isCheck\": %ld, \"copyBoard\": %ld, \"tested\": %ld, "
+			"\"played\": %ld, \"rejected\": %ld, \"moveMs\": %.3f, "
+			"\"resultMs\": %.3f}\n", stats.checks, stats.copies, stats.tested,
+			stats.played, stats.rejected, moveMs, resultMs);
+	} else {
+		printf("isCheck calls:   %ld\n", stats.checks);
+		printf("board copies:    %ld\n", stats.copies);
+		printf("moves tested:    %ld\n", stats.tested);
+		printf("moves played:    %ld\n", stats.played);
+		printf("moves rejected:  %ld\n", stats.rejected);
+		printf("move time:       %.3f ms\n", moveMs);
+		printf("result time:     %.3f ms\n", resultMs);
+	}
+#else
+	printf("Statistics not compiled in (build with -DSTATS).\n");
+#endif
+}
+
+// the SAN of the legal move that turned before into board
+void recordMove(char *san, char before[][FILES], struct move *legal, int n,
+		char board[][FILES], int checked) {
+	char tester[RANKS][FILES];
+
+	*san = 0;
+	for (int i = 0; i < n; i++) {
+		copyBoard(tester, before);
+		applyMove(tester, &legal[i]);
+		if (!memcmp(tester, board, sizeof(tester))) {
+			writeSan(before, legal, n, i, san);
+			break;
+		}
+	}
+	if (checked) {
+		strcat(san, (checked < 0) ? "#" : "+");
+	}
+}
+
+void writePgn(char *path, char history[][MAX_SAN], int plies, char *result) {
+	FILE *fp = fopen(path, "a");
+	time_t now = time(0);
+	char date[16];
+	int col = 0;
+
+	if (!fp) {
+		printf("Cannot open %s.\n", path);
+		return;
+	}
+
+	strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+	fprintf(fp, "[Event \"simple-chess game\"]\n");
+	fprintf(fp, "[Site \"?\"]\n");
+	fprintf(fp, "[Date \"%s\"]\n", date);
+	fprintf(fp, "[Round \"-\"]\n");
+	fprintf(fp, "[White \"?\"]\n");
+	fprintf(fp, "[Black \"?\"]\n");
+	fprintf(fp, "[Result \"%s\"]\n\n", result);
+
+	for (int i = 0; i < plies; i++) {
+		if (col > 70) {
+			fprintf(fp, "\n");
+			col = 0;
+		}
+		if (i % 2 == 0) {
+			col += fprintf(fp, "%d. ", i / 2 + 1);
+		}
+		col += fprintf(fp, "%s ", history[i]);
+	}
+	fprintf(fp, "%s\n\n", result);
+	fclose(fp);
+}
+
+int storePosition(unsigned char records[][RECORD_SIZE], uint64_t *hashes,
+		int n, char board[][FILES], int turn) {
+	unsigned char *rec = records[n];
+	uint64_t hash = UINT64_C(14695981039346656037);	// FNV-1a
+
+	for (int i = 0; i < RANKS * FILES; i += 2) {
+		rec[i/2] = (pieceCode(board[i/8][i%8]) << 4) |
+			pieceCode(board[i/8][i%8 + 1]);
+	}
+	rec[32] = turn;
+	rec[33] = 0;
+
+	for (int i = 0; i < 33; i++) {
+		hash = (hash ^ rec[i]) * UINT64_C(1099511628211);
+	}
+	for (int i = 0; i < n; i++) {
+		if (hashes[i] == hash) {
+			return 0;	// repeated position
+		}
+	}
+	hashes[n] = hash;
+
+	return 1;
+}
+
+int pieceCode(char c) {
+	const char *codes = ".pnbrqk";
+	char *p;
+
+	if (c >= 'A' && c <= 'Z') {
+		return 8 | pieceCode(c + 32);	// black
+	}
+	p = strchr(codes, c);
+
+	return p ? p - codes : 0;
+}
+
+void writeRecords(char *path, unsigned char records[][RECORD_SIZE], int n,
+		char *score) {
+	FILE *fp;
+	int result;
+
+	if (!strcmp(score, "*")) {
+		return;	// unfinished games carry no label
+	}
+	result = !strcmp(score, "1-0") ? 2 : (!strcmp(score, "0-1") ? 0 : 1);
+
+	if (!(fp = fopen(path, "ab"))) {
+		printf("Cannot open %s.\n", path);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		records[i][33] = result;
+	}
+	fwrite(records, RECORD_SIZE, n, fp);
+	fclose(fp);
+}
+
+void analyze(char board[][FILES], int turn, int kings[][2], char *enPassant,
+		int hasCastled[][2]) {
+	struct candidate list[MAX_LEGAL];
+	int n = rankMoves(board, turn, kings, enPassant, hasCastled,
+		ANALYZE_DEPTH, list);
+	char value[24];
+
+	if (!n) {
+		printf("No legal moves.\n");
+	}
+	for (int i = 0; i < n && i < MAX_LINES; i++) {
+		if (list[i].mate) {
+			sprintf(value, "%s %d", list[i].mate > 0 ? "mate" : "mated",
+				list[i].mate > 0 ? list[i].mate : -list[i].mate);
+		} else {
+			sprintf(value, "%+d", list[i].score);
+		}
+		printf("  %-10s %-8s", list[i].san, value);
+		for (int j = 0; j < list[i].pvLength; j++) {
+			printf(" %s", list[i].pv[j]);
+		}
+		printf("\n");
+	}
+}
+
+// scores every legal move by material after it, mates first
+// searches each legal move depth plies deep and sorts them best first
+int rankMoves(char board[][FILES], int turn, int kings[][2], char *enPassant,
+		int hasCastled[][2], int depth, struct candidate *list) {
+	struct move moves[MAX_LEGAL], line[MAX_LINE];
+	struct candidate temp;
+	char tester[RANKS][FILES];
+	int testKings[2][2], testCastled[2][2];
+	char testPassant[2];
+	int n, k, length, plies;
+
+	depth = (depth < 1) ? 1 : (depth > MAX_DEPTH ? MAX_DEPTH : depth);
+	n = generateMoves(board, turn, kings, enPassant, hasCastled, moves,
+		MAX_LEGAL);
+	for (int i = 0; i < n; i++) {
+		copyBoard(tester, board);
+		memcpy(testKings, kings, sizeof(testKings));
+		memcpy(testCastled, hasCastled, sizeof(testCastled));
+		memcpy(testPassant, enPassant, sizeof(testPassant));
+		playMove(tester, turn, &moves[i], testKings, testPassant, testCastled);
+		testPassant[turn^1] = 0;
+
+		line[0] = moves[i];
+		list[i].value = -search(tester, turn^1, testKings, testPassant,
+			testCastled, depth - 1, 1, -MATE - 1, MATE + 1, line + 1, &length);
+		writeLine(board, turn, kings, enPassant, hasCastled, line, length + 1,
+			&list[i]);
+		plies = MATE - (list[i].value < 0 ? -list[i].value : list[i].value);
+		list[i].mate = (plies > MAX_LINE) ? 0 :
+			(list[i].value > 0 ? (plies + 1) / 2 : -plies / 2);
+		if (!list[i].mate) {
+			list[i].score = list[i].value;
+		}
+	}
+
+	// best first; insertion sort keeps board order among ties
+	for (int i = 1; i < n; i++) {
+		temp = list[i];
+		for (k = i; k > 0 && list[k-1].value < temp.value; k--) {
+			list[k] = list[k-1];
+		}
+		list[k] = temp;
+	}
+
+	return n;
+}
+
+// negamax with alpha-beta: 0 for stalemate or bare kings, -(MATE - ply)
+// when mated, and below depth 0 material once no capture improves it;
+// pv gets the best line from here
+int search(char board[][FILES], int turn, int kings[][2], char *enPassant,
+		int hasCastled[][2], int depth, int ply, int alpha, int beta,
+		struct move *pv, int *pvLength) {
+	struct move moves[MAX_LEGAL], line[MAX_LINE];
+	char tester[RANKS][FILES];
+	int testKings[2][2], testCastled[2][2];
+	char testPassant[2];
+	int n, score, length;
+
+	*pvLength = 0;
+	n = generateMoves(board, turn, kings, enPassant, hasCastled, moves,
+		MAX_LEGAL);
+	if (!n) {
+		return isCheck(board, turn, kings[turn][0], kings[turn][1], 0) ?
+			-(MATE - ply) : 0;
+	} else if (isInsufficientMaterial(board)) {
+		return 0;
+	} else if (depth < 1) {
+		score = material(board, turn);
+		if (score >= beta) {
+			return beta;
+		} else if (score > alpha) {
+			alpha = score;
+		}
+		if (ply >= MAX_LINE - 1) {
+			return alpha;
+		}
+	}
+	n = orderMoves(board, moves, n, depth < 1);
+
+	for (int i = 0; i < n; i++) {
+		copyBoard(tester, board);
+		memcpy(testKings, kings, sizeof(testKings));
+		memcpy(testCastled, hasCastled, sizeof(testCastled));
+		memcpy(testPassant, enPassant, sizeof(testPassant));
+		playMove(tester, turn, &moves[i], testKings, testPassant, testCastled);
+		testPassant[turn^1] = 0;
+
+		score = -search(tester, turn^1, testKings, testPassant, testCastled,
+			depth - 1, ply + 1, -beta, -alpha, line, &length);
+		if (score > alpha) {
+			alpha = score;
+			pv[0] = moves[i];
+			memcpy(pv + 1, line, length * sizeof(*line));
+			*pvLength = length + 1;
+			if (alpha >= beta) {
+				break;
+			}
+		}
+	}
+
+	return alpha;
+}
+
+// captures first, most valuable victim then least valuable attacker;
+// with capturesOnly the quiet moves are dropped
+int orderMoves(char board[][FILES], struct move *moves, int n,
+		int capturesOnly) {
+	int keys[MAX_LEGAL];
+	int count = 0, key, k;
+	char piece;
+	struct move m;
+
+	for (int i = 0; i < n; i++) {
+		m = moves[i];
+		piece = board[m.row0][m.col0];
+		key = worth[pieceCode(board[m.row1][m.col1]) & 7];
+		if (isPawn(piece) && m.col0 != m.col1 && !key) {
+			key = worth[1];	// en passant lands on an empty square
+		}
+		if (m.promotion) {
+			key += worth[pieceCode(m.promotion | 32)] - worth[1];
+		}
+		if (key) {
+			key = key * 16 - worth[pieceCode(piece) & 7];
+		} else if (capturesOnly) {
+			continue;
+		}
+		for (k = count; k > 0 && keys[k-1] < key; k--) {
+			moves[k] = moves[k-1];
+			keys[k] = keys[k-1];
+		}
+		moves[k] = m;
+		keys[k] = key;
+		count++;
+	}
+
+	return count;
+}
+
+// replays a line as SAN with check marks; score is material at its end
+void writeLine(char board[][FILES], int turn, int kings[][2],
+		char *enPassant, int hasCastled[][2], struct move *line, int length,
+		struct candidate *c) {
+	struct move moves[MAX_LEGAL];
+	char tester[RANKS][FILES];
+	int testKings[2][2], testCastled[2][2];
+	char testPassant[2];
+	int n, i, checked;
+
+	copyBoard(tester, board);
+	memcpy(testKings, kings, sizeof(testKings));
+	memcpy(testCastled, hasCastled, sizeof(testCastled));
+	memcpy(testPassant, enPassant, sizeof(testPassant));
+	c->pvLength = 0;
+	for (int ply = 0; ply < length; ply++) {
+		n = generateMoves(tester, turn, testKings, testPassant, testCastled,
+			moves, MAX_LEGAL);
+		for (i = 0; i < n && memcmp(&moves[i], &line[ply], sizeof(*line));
+				i++) {
+		}
+		if (i == n) {
+			break;
+		}
+		writeSan(tester, moves, n, i, c->pv[ply]);
+		playMove(tester, turn, &moves[i], testKings, testPassant, testCastled);
+		testPassant[turn^1] = 0;
+		turn ^= 1;
+		checked = isCheck(tester, turn, testKings[turn][0], testKings[turn][1],
+			testPassant);
+		if (checked) {
+			strcat(c->pv[ply], (checked < 0) ? "#" : "+");
+		}
+		c->pvLength++;
+	}
+	strcpy(c->san, c->pv[0]);
+	c->score = material(tester, turn) * ((c->pvLength % 2) ? -1 : 1);
+}
+
+// SAN for moves[i], disambiguated against the other legal moves
+void writeSan(char board[][FILES], struct move *moves, int n, int i,
+		char *san) {
+	struct move *m = &moves[i];
+	struct move *o;
+	char piece = board[m->row0][m->col0];
+	int file = 0, rank = 0, others = 0;
+
+	if (isKing(piece) && (m->col1 - m->col0) * (m->col1 - m->col0) == 4) {
+		strcpy(san, (m->col1 > m->col0) ? "O-O" : "O-O-O");
+		return;
+	}
+
+	if (isPawn(piece)) {
+		if (m->col0 != m->col1) {
+			*san++ = getFile(m->col0);
+			*san++ = 'x';
+		}
+	} else {
+		*san++ = piece & ~32;
+		for (int k = 0; k < n; k++) {
+			o = &moves[k];
+			if (k != i && board[o->row0][o->col0] == piece &&
+					o->row1 == m->row1 && o->col1 == m->col1) {
+				others++;
+				file += (o->col0 == m->col0);
+				rank += (o->row0 == m->row0);
+			}
+		}
+		if (others && (!file || rank)) {
+			*san++ = getFile(m->col0);
+		}
+		if (others && file) {
+			*san++ = getRank(m->row0);
+		}
+		if (board[m->row1][m->col1] != '.') {
+			*san++ = 'x';
+		}
+	}
+	*san++ = getFile(m->col1);
+	*san++ = getRank(m->row1);
+	if (m->promotion) {
+		*san++ = '=';
+		*san++ = m->promotion;
+	}
+	*san = 0;
+}
+
+int material(char board[][FILES], int turn) {
+	int code, sum = 0;
+
+	for (int i = 0; i < RANKS; i++) {
+		for (int j = 0; j < FILES; j++) {
+			code = pieceCode(board[i][j]);
+			sum += ((code >> 3) == turn ? 1 : -1) * worth[code & 7];
+		}
+	}
+
+	return sum;
+}
+
+// one FEN per line in, one JSON line with the top moves per position out
+void analyzeFile(char *path, int lines, int depth) {
+	FILE *fp = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	char fen[MAX_FEN];
+	char board[RANKS][FILES];
+	int turn, kings[2][2], hasCastled[2][2];
+	char enPassant[2];
+	struct candidate list[MAX_LEGAL];
+	int n, c, line = 0;
+
+	if (!fp) {
+		printf("Cannot open %s.\n", path);
+		return;
+	}
+
+	while (fgets(fen, sizeof(fen), fp)) {
+		line++;
+		if (!strchr(fen, '\n') && (c = fgetc(fp)) != EOF && c != '\n') {
+			while ((c = fgetc(fp)) != EOF && c != '\n') {
+			}
+			printf("{\"line\": %d, \"error\": \"line too long\"}\n", line);
+			continue;
+		}
+		fen[strcspn(fen, "\r\n")] = 0;
+		if (!fen[0]) {
+			continue;
+		}
+		if (!loadFen(fen, board, &turn, enPassant, hasCastled)) {
+			printf("{\"line\": %d, \"error\": \"invalid FEN\"}\n", line);
+			continue;
+		}
+		setupKings(board, kings);
+		n = rankMoves(board, turn, kings, enPassant, hasCastled, depth, list);
+		printf("{\"line\": %d, \"fen\": \"%s\", \"moves\": [", line, fen);
+		for (int i = 0; i < n && i < lines; i++) {
+			printf("%s{\"san\": \"%s\", \"score\": %d, \"mate\": %d, "
+				"\"pv\": [", i ? ", " : "", list[i].san, list[i].score,
+				list[i].mate);
+			for (int j = 0; j < list[i].pvLength; j++) {
+				printf("%s\"%s\"", j ? ", " : "", list[i].pv[j]);
+			}
+			printf("]}");
+		}
+		printf("]}\n");
+	}
+
+	if (fp != stdin) {
+		fclose(fp);
+	}
+}
+
+// board, side to move, castling and en passant fields of a FEN string
+int loadFen(const char *fen, char board[][FILES], int *turn, char *enPassant,
+		int hasCastled[][2]) {
+	int row = 0, col = 0, white = 0, black = 0;
+	int used = 0, clock, number;
+	char side, rights[8], ep[4];
+	const char *p;
+
+	// also keeps the echoed FEN safe inside a JSON string
+	if (fen[strspn(fen, "KQRBNPkqrbnp/0123456789 w-acdefgh")]) {
+		return 0;
+	}
+	for (p = fen; *p && *p != ' '; p++) {
+		if (*p == '/') {
+			if (col != FILES || ++row >= RANKS) {
+				return 0;
+			}
+			col = 0;
+		} else if (*p >= '1' && *p <= '8') {
+			for (int k = *p - '0'; k > 0; k--) {
+				if (col >= FILES) {
+					return 0;
+				}
+				board[row][col++] = '.';
+			}
+		} else if (strchr("KQRBNPkqrbnp", *p) && col < FILES) {
+			white += (*p == 'K');
+			black += (*p == 'k');
+			board[row][col++] = *p ^ 32;	// FEN has white in upper case
+		} else {
+			return 0;
+		}
+	}
+	if (row != RANKS - 1 || col != FILES || white != 1 || black != 1 ||
+			sscanf(p, " %c %7s %3s%n", &side, rights, ep, &used) != 3 ||
+			(side != 'w' && side != 'b') ||
+			(strcmp(rights, "-") && rights[strspn(rights, "KQkq")]) ||
+			(strcmp(ep, "-") && (!isFile(ep[0]) || (ep[1] != '3' &&
+			ep[1] != '6') || ep[2]))) {
+		return 0;
+	}
+	// the move counters are optional, anything else is not
+	p += used;
+	if (sscanf(p, " %d %d%n", &clock, &number, &used) == 2) {
+		p += used;
+	}
+	if (p[strspn(p, " ")]) {
+		return 0;
+	}
+
+	*turn = (side == 'b') ? BLACK : WHITE;
+	hasCastled[WHITE][0] = !strchr(rights, 'Q');
+	hasCastled[WHITE][1] = !strchr(rights, 'K');
+	hasCastled[BLACK][0] = !strchr(rights, 'q');
+	hasCastled[BLACK][1] = !strchr(rights, 'k');
+	enPassant[*turn] = 0;
+	enPassant[*turn^1] = isFile(ep[0]) ? ep[0] : 0;
+
+	return 1;
+}
+
+// leaf nodes of the legal move tree, the standard move generator check
+long perft(char board[][FILES], int turn, int kings[][2], char *enPassant,
+		int hasCastled[][2], int depth) {
+	struct move list[MAX_LEGAL];
+	char tester[RANKS][FILES];
+	int testKings[2][2], testCastled[2][2];
+	char testPassant[2];
+	long nodes = 0;
+	int n;
+
+	if (depth < 1) {
+		return 1;
+	}
+	n = generateMoves(board, turn, kings, enPassant, hasCastled, list,
+		MAX_LEGAL);
+	if (depth == 1) {
+		return n;
+	}
+
+	for (int i = 0; i < n; i++) {
+		copyBoard(tester, board);
+		memcpy(testKings, kings, sizeof(testKings));
+		memcpy(testCastled, hasCastled, sizeof(testCastled));
+		memcpy(testPassant, enPassant, sizeof(testPassant));
+		playMove(tester, turn, &list[i], testKings, testPassant, testCastled);
+		testPassant[turn^1] = 0;
+		nodes += perft(tester, turn^1, testKings, testPassant, testCastled,
+			depth - 1);
+	}
+
+	return nodes;
+}
+
+int runPerft(int depth, const char *fen) {
+	char board[RANKS][FILES];
+	int turn, kings[2][2], hasCastled[2][2];
+	char enPassant[2];
+
+	if (!loadFen(fen, board, &turn, enPassant, hasCastled)) {
+		printf("Invalid FEN.\n");
+		return 1;
+	}
+	setupKings(board, kings);
+	printf("perft(%d) = %ld\n", depth,
+		perft(board, turn, kings, enPassant, hasCastled, depth));
+
+	return 0;
+}
+
+// random legal games from fen, checking the game's move path against the
+// generator and a reference built without applyMove or trackCastle
+int fuzz(int games, unsigned seed, const char *fen) {
+	char board[RANKS][FILES];
+	int turn, hasCastled[2][2];
+	char enPassant[2];
+	int failures = 0;
+
+	if (!loadFen(fen, board, &turn, enPassant, hasCastled)) {
+		printf("Invalid FEN.\n");
+		return 1;
+	}
+	srand(seed);
+	for (int i = 0; i < games; i++) {
+		failures += fuzzGame(i, seed, fen);
+	}
+	printf("fuzz: %d games, %d failures\n", games, failures);
+
+	return failures != 0;
+}
+
+int fuzzGame(int game, unsigned seed, const char *fen) {
+	char board[RANKS][FILES], before[RANKS][FILES], ref[RANKS][FILES];
+	int turn, kings[2][2], hasCastled[2][2];
+	int refCastled[2][2], scanned[2][2];
+	char enPassant[2];
+	struct move list[MAX_LEGAL];
+	char input[MAX_SAN], promotion;
+	int n, i, command, result, inCheck, mated;
+	const char *error = 0;
+
+	loadFen(fen, board, &turn, enPassant, hasCastled);
+	setupKings(board, kings);
+	memcpy(refCastled, hasCastled, sizeof(refCastled));
+
+	for (int ply = 0; ply < FUZZ_PLIES && !error; ply++) {
+		// terminal detection against the full move count
+		n = generateMoves(board, turn, kings, enPassant, hasCastled, list,
+			MAX_LEGAL);
+		inCheck = isCheck(board, turn, kings[turn][0], kings[turn][1], 0) != 0;
+		mated = isCheck(board, turn, kings[turn][0], kings[turn][1],
+			enPassant) == -1;
+		if (mated != (inCheck && !n)) {
+			error = "checkmate detection disagrees with move count";
+		} else if (!inCheck && isStalemate(board, turn, kings[turn][0],
+				kings[turn][1], enPassant) != !n) {
+			error = "stalemate detection disagrees with move count";
+		}
+		if (error || !n) {
+			break;
+		}
+
+		// reference: the generated move made square by square
+		i = rand() % n;
+		copyBoard(before, board);
+		copyBoard(ref, board);
+		referenceMove(ref, turn, &list[i]);
+		referenceRights(ref, refCastled);
+		setupKings(ref, scanned);
+
+		// game path: its SAN typed through the parser and canMove
+		writeSan(board, list, n, i, input);
+		if (isCheck(ref, turn^1, scanned[turn^1][0], scanned[turn^1][1], 0)) {
+			strcat(input, "+");
+		}
+		promotion = stripSuffix(input);
+		if (!(command = validateInput(input))) {
+			error = "SAN rejected by validateInput";
+			break;
+		} else if (command >= 5) {
+			result = canCastle(board, turn, command-5, hasCastled, kings,
+				enPassant);
+		} else {
+			result = canMove(board, turn, input, command, enPassant,
+				hasCastled, kings, &promotion);
+		}
+
+		if (!result) {
+			error = "legal move rejected";
+		} else if (memcmp(board, ref, sizeof(ref))) {
+			error = "board differs from the reference move";
+		} else if (memcmp(kings, scanned, sizeof(kings))) {
+			error = "tracked king squares are wrong";
+		} else if (memcmp(hasCastled, refCastled, sizeof(hasCastled))) {
+			error = "castling rights differ from the home squares";
+		} else if (enPassant[turn] != referencePassant(before, board, turn)) {
+			error = "en passant file differs from the pawn double step";
+		}
+		if (error) {
+			printf("fuzz: seed %u game %d ply %d %s: %s\n", seed, game, ply,
+				input, error);
+			return 1;
+		}
+
+		turn ^= 1;
+		enPassant[turn] = 0;
+	}
+	if (error) {
+		printf("fuzz: seed %u game %d: %s\n", seed, game, error);
+		return 1;
+	}
+
+	return 0;
+}
+
+// makes a move from the squares alone, separately from applyMove
+void referenceMove(char board[][FILES], int turn, struct move *m) {
+	char piece = board[m->row0][m->col0];
+	int row = m->row0;
+
+	board[m->row0][m->col0] = '.';
+	if ((piece == 'p' || piece == 'P') && m->col0 != m->col1 &&
+			board[m->row1][m->col1] == '.') {
+		board[row][m->col1] = '.';
+	}
+	if ((piece == 'k' || piece == 'K') && m->col1 == m->col0 + 2) {
+		board[row][5] = board[row][7];
+		board[row][7] = '.';
+	} else if ((piece == 'k' || piece == 'K') && m->col1 == m->col0 - 2) {
+		board[row][3] = board[row][0];
+		board[row][0] = '.';
+	}
+	if (m->promotion) {
+		piece = (turn == WHITE) ? m->promotion + 32 : m->promotion;
+	}
+	board[m->row1][m->col1] = piece;
+}
+
+// a right is gone for good once its king or rook leaves its home square
+void referenceRights(char board[][FILES], int hasCastled[][2]) {
+	const char *home[] = {"rk", "RK"};	// rook, king of each colour
+
+	for (int side = WHITE; side <= BLACK; side++) {
+		int row = (side == WHITE) ? 7 : 0;
+
+		for (int kingside = 0; kingside < 2; kingside++) {
+			if (board[row][4] != home[side][1] ||
+					board[row][kingside ? 7 : 0] != home[side][0]) {
+				hasCastled[side][kingside] = 1;
+			}
+		}
+	}
+}
+
+// the file a pawn of turn's double-stepped on, read off the two boards
+char referencePassant(char before[][FILES], char after[][FILES], int turn) {
+	char pawn = (turn == WHITE) ? 'p' : 'P';
+	int start = (turn == WHITE) ? 6 : 1;
+	int landing = (turn == WHITE) ? 4 : 3;
+
+	for (int c = 0; c < FILES; c++) {
+		if (before[start][c] == pawn && after[start][c] == '.' &&
+				before[landing][c] == '.' && after[landing][c] == pawn) {
+			return getFile(c);
+		}
+	}
+
+	return 0;
+}
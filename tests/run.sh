@@ -0,0 +1,66 @@
+#!/bin/sh
+# Regression tests: perft on the standard positions, scripted games, PGN,
+# training record and analyze output, and random games from each perft
+# position. perft is the check on move generation; fuzz plays generated
+# moves through the game's SAN parser and canMove and compares the result
+# with a reference move, castling rights and en passant file worked out
+# separately from applyMove and trackCastle.
+# Usage: tests/run.sh [CHESS]
+CHESS=${1:-./chess}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# count, result bytes and last record in hex of a 34-byte record file
+records() {
+	[ -s "$1" ] || { echo 0; return; }
+	echo "$(($(wc -c < "$1") / 34)) $(od -An -tu1 -v "$1" |
+		awk '{ for (i = 1; i <= NF; i++) if (++n % 34 == 0) print $i }' |
+		sort -u | tr '\n' ' ')$(tail -c 34 "$1" | od -An -tx1 -v |
+		tr -d ' \n')"
+}
+
+out=$({
+	grep -v '^#' "$DIR/perft.txt" | while read -r depth nodes fen; do
+		got=$("$CHESS" perft "$depth" "$fen")
+		[ "$got" = "perft($depth) = $nodes" ] ||
+			echo "FAIL: perft $depth $fen: $got" >&2
+	done
+
+	grep -v '^#' "$DIR/games.txt" | while IFS='|' read -r expected moves; do
+		printf '%s\nquit\n' "$moves" | tr ' ' '\n' | "$CHESS" |
+			grep -qF "$expected" ||
+			echo "FAIL: game $moves: expected '$expected'" >&2
+	done
+
+	grep -v '^#' "$DIR/pgn.txt" | while IFS='|' read -r expected moves; do
+		printf '%s\nquit\n' "$moves" | tr ' ' '\n' |
+			"$CHESS" pgn "$TMP/game.pgn" > /dev/null
+		got=$(tail -n 2 "$TMP/game.pgn" | head -n 1)
+		rm -f "$TMP/game.pgn"
+		[ "$got" = "$expected" ] || echo "FAIL: pgn $moves: $got" >&2
+	done
+
+	grep -v '^#' "$DIR/train.txt" | while IFS='|' read -r expected moves; do
+		printf '%s\nquit\n' "$moves" | tr ' ' '\n' |
+			"$CHESS" train "$TMP/game.bin" > /dev/null
+		got=$(records "$TMP/game.bin")
+		rm -f "$TMP/game.bin"
+		[ "$got" = "$expected" ] || echo "FAIL: train $moves: $got" >&2
+	done
+
+	grep -v '^#' "$DIR/analyze.txt" | while IFS='|' read -r expected fen; do
+		got=$(printf '%s\n' "$fen" | "$CHESS" analyze - 1)
+		[ "$got" = "$expected" ] || echo "FAIL: analyze $fen: $got" >&2
+	done
+
+	got=$("$CHESS" fuzz 200 1) || echo "FAIL: $got" >&2
+	grep -v '^#' "$DIR/perft.txt" | while read -r depth nodes fen; do
+		got=$("$CHESS" fuzz 20 1 "$fen") || echo "FAIL: $fen: $got" >&2
+	done
+} 2>&1)
+
+[ -z "$out" ] || echo "$out"
+failures=$(echo "$out" | grep -c '^FAIL')
+echo "tests: $failures failures"
+[ "$failures" -eq 0 ]